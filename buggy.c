@@ -66,6 +66,7 @@ int main(int argc, const char *argv[])
         printf("<num> is a value from 1 to 7 identifying which error to execute.\n");
         exit(1);
     }
+    RecordBreadcrumb("MakeMemoryError", atoi(argv[1]), 0, 0);
     MakeMemoryError(atoi(argv[1]));
     return 0;
 }
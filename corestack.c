@@ -0,0 +1,251 @@
+/* corestack.c
+ * -----------
+ * Prints a symbolic backtrace for every thread of an ELF core file without
+ * loading it into a debugger. The core is memory-mapped and never copied:
+ * registers come from the NT_PRSTATUS notes and each stack is walked along
+ * its saved-rbp chain by translating addresses straight into the PT_LOAD
+ * segments of the mapping, so only the pages actually touched are read.
+ * Frames are symbolized against the executable that produced the core.
+ */
+#include <elf.h>
+#include <fcntl.h>		// open
+#include <sys/mman.h>		// mmap
+#include <sys/stat.h>		// fstat
+#include <sys/procfs.h>		// elf_prstatus
+#include <sys/user.h>		// user_regs_struct
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>		// ptrdiff_t
+#include "symbols.h"
+#include "cvector.h"
+
+#define MAX_FRAMES 256
+
+/* Type: CORE_SEGMENT
+ * ------------------
+ * The part of a PT_LOAD segment whose contents were dumped into the core,
+ * and where those bytes sit inside the mapping.
+ */
+typedef struct {
+  Elf64_Addr vaddr;
+  Elf64_Xword filesz;
+  const uint8_t *data;
+} CORE_SEGMENT;
+
+static CVector *g_vector_segments = NULL;
+
+int segment_compare(const void *elemAddr1, const void *elemAddr2)
+{
+  const CORE_SEGMENT *segment1 = elemAddr1;
+  const CORE_SEGMENT *segment2 = elemAddr2;
+  if(segment1->vaddr == segment2->vaddr) return 0;
+  return (segment1->vaddr < segment2->vaddr) ? -1 : 1;
+}
+
+int segment_search_compare(const void *elemAddr1, const void *elemAddr2)
+{
+  Elf64_Addr addr = *(const Elf64_Addr *)elemAddr1;
+  const CORE_SEGMENT *segment = elemAddr2;
+  if(addr < segment->vaddr) return -1;
+  return (addr < segment->vaddr + segment->filesz) ? 0 : 1;
+}
+
+/* Function: ReadCoreWord
+ * ----------------------
+ * Reads the 8-byte word at virtual address addr of the crashed process.
+ * Returns 0 and fills *value when the word was dumped into the core, -1
+ * otherwise. The segments are binary searched directly rather than through
+ * CVectorSearch, whose sorted search ends in a linear scan.
+ */
+static int ReadCoreWord(Elf64_Addr addr, uint64_t *value)
+{
+  int count = CVectorCount(g_vector_segments);
+  if(count == 0) return -1;
+  CORE_SEGMENT *segments = CVectorNth(g_vector_segments, 0);
+  int lo = 0, hi = count;
+  while(lo < hi)
+  {
+    int mid = lo + (hi - lo) / 2;
+    int cmp = segment_search_compare(&addr, &segments[mid]);
+    if(cmp == 0)
+    {
+      if(addr - segments[mid].vaddr + sizeof(uint64_t) > segments[mid].filesz) return -1;
+      memcpy(value, segments[mid].data + (addr - segments[mid].vaddr), sizeof(uint64_t));
+      return 0;
+    }
+    if(cmp < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  return -1;
+}
+
+/* Function: FindLoadBias
+ * ----------------------
+ * Reads AT_ENTRY out of the NT_AUXV note and returns how far the process's
+ * entry point was moved from the executable's e_entry, which is the load
+ * bias of a PIE (and zero otherwise). Sets *found to 0 if the note holds
+ * no AT_ENTRY.
+ */
+static Elf64_Addr FindLoadBias(const uint8_t *desc, Elf64_Word descsz, int *found)
+{
+  const Elf64_auxv_t *auxv = (const Elf64_auxv_t *)desc;
+  size_t count = descsz / sizeof(Elf64_auxv_t);
+  for(size_t i = 0 ; i < count && auxv[i].a_type != AT_NULL ; i++)
+  {
+    if(auxv[i].a_type == AT_ENTRY)
+    {
+      *found = 1;
+      return auxv[i].a_un.a_val - ObjectFileEntry();
+    }
+  }
+  *found = 0;
+  return 0;
+}
+
+/* Function: PrintThreadBacktrace
+ * ------------------------------
+ * Follows the saved-rbp chain of one thread, in the same format the crash
+ * reporter uses. The walk stops at main, at an address outside any known
+ * function, at a frame that was not dumped, or when the chain stops moving
+ * up the stack. Only the thread that took the signal (crashed != 0) gets
+ * its first frame labelled as the faulting instruction; the others were
+ * merely stopped wherever they were when the core was written.
+ */
+static void PrintThreadBacktrace(const struct elf_prstatus *status, Elf64_Addr bias,
+  int crashed)
+{
+  const struct user_regs_struct *regs = (const struct user_regs_struct *)&status->pr_reg;
+  long long int offset;
+  if(crashed)
+    printf("\nThread %d (received signal %d)\n", (int)status->pr_pid, (int)status->pr_cursig);
+  else
+    printf("\nThread %d\n", (int)status->pr_pid);
+  const char *symbol = LookupAddress(regs->rip - bias, &offset);
+  printf("%s [%018llx] %s (+0x%llx)\n", crashed ? "Faulting instruction at" : "Stopped at",
+    regs->rip, (symbol != NULL) ? symbol : "Unknown", (symbol != NULL) ? offset : 0);
+  uint64_t rbp = regs->rbp, next_rbp, ret_addr;
+  for(int i = 0 ; i < MAX_FRAMES ; i++)
+  {
+    if(symbol != NULL && strcmp(symbol, "main") == 0) break;
+    if(ReadCoreWord(rbp, &next_rbp) != 0 || ReadCoreWord(rbp + 8, &ret_addr) != 0)
+      break;
+    symbol = LookupAddress(ret_addr - bias, &offset);
+    if(symbol == NULL)
+    {
+      printf("[%018lx] %s (+0x%llx)\n", ret_addr, "Unknown", (long long unsigned int)0);
+      break;
+    }
+    printf("[%018lx] %s (+0x%llx)\n", ret_addr, symbol, offset);
+    if(next_rbp <= rbp) break;
+    rbp = next_rbp;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc != 3)
+  {
+    fprintf(stderr, "Usage: %s executable core\n", argv[0]);
+    return 1;
+  }
+  if(ObjectFileOpen(argv[1]) != 0)
+  {
+    fprintf(stderr, "Cannot read symbols from %s\n", argv[1]);
+    return 1;
+  }
+
+  int fd = open(argv[2], O_RDONLY);
+  struct stat st;
+  if(fd == -1 || fstat(fd, &st) == -1)
+  {
+    fprintf(stderr, "Cannot open core file %s\n", argv[2]);
+    return 1;
+  }
+  size_t core_size = st.st_size;
+  uint8_t *core = (core_size > 0) ? mmap(0, core_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  Elf64_Ehdr *hdr = (Elf64_Ehdr *)core;
+  if(core == MAP_FAILED || core_size < sizeof(Elf64_Ehdr) ||
+    memcmp(hdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+    hdr->e_ident[EI_CLASS] != ELFCLASS64 || hdr->e_type != ET_CORE)
+  {
+    fprintf(stderr, "%s is not a 64-bit ELF core file\n", argv[2]);
+    return 1;
+  }
+  //the registers are read as x86-64 user_regs_struct
+  if(hdr->e_machine != EM_X86_64)
+  {
+    fprintf(stderr, "%s is not an x86-64 core file\n", argv[2]);
+    return 1;
+  }
+  if(hdr->e_phoff > core_size ||
+    (core_size - hdr->e_phoff) / sizeof(Elf64_Phdr) < hdr->e_phnum)
+  {
+    fprintf(stderr, "%s is truncated before its program headers\n", argv[2]);
+    return 1;
+  }
+
+  Elf64_Phdr *ph_ptr = (Elf64_Phdr *)(core + hdr->e_phoff);
+  g_vector_segments = CVectorCreate(sizeof(CORE_SEGMENT), hdr->e_phnum, NULL);
+  for(int i = 0 ; i < hdr->e_phnum ; i++)
+  {
+    if(ph_ptr[i].p_type != PT_LOAD || ph_ptr[i].p_offset >= core_size) continue;
+    //a core cut short by ulimit -c still holds the start of its last segments
+    Elf64_Xword filesz = ph_ptr[i].p_filesz;
+    if(filesz > core_size - ph_ptr[i].p_offset) filesz = core_size - ph_ptr[i].p_offset;
+    if(filesz == 0) continue;
+    CORE_SEGMENT segment = { ph_ptr[i].p_vaddr, filesz, core + ph_ptr[i].p_offset };
+    CVectorAppend(g_vector_segments, &segment);
+  }
+  CVectorSort(g_vector_segments, segment_compare);
+
+  //the bias is needed before any thread is printed, and NT_AUXV comes after
+  //the NT_PRSTATUS notes, so the notes are walked twice
+  Elf64_Addr bias = 0;
+  int found_auxv = 0;
+  int threads_printed = 0;
+  for(int pass = 0 ; pass < 2 ; pass++)
+  {
+    if(pass == 1 && !found_auxv)
+      fprintf(stderr, "warning: no AT_ENTRY in %s, assuming %s was not relocated\n",
+        argv[2], argv[1]);
+    if(pass == 1 && (bias & 0xfff) != 0)
+      fprintf(stderr, "warning: entry points disagree, %s may not be the executable that "
+        "produced %s\n", argv[1], argv[2]);
+    for(int i = 0 ; i < hdr->e_phnum ; i++)
+    {
+      if(ph_ptr[i].p_type != PT_NOTE || ph_ptr[i].p_offset >= core_size) continue;
+      const uint8_t *note = core + ph_ptr[i].p_offset;
+      const uint8_t *end = core + core_size;
+      if(ph_ptr[i].p_filesz < core_size - ph_ptr[i].p_offset)
+        end = note + ph_ptr[i].p_filesz;
+      while(end - note >= (ptrdiff_t)sizeof(Elf64_Nhdr))
+      {
+        const Elf64_Nhdr *nhdr = (const Elf64_Nhdr *)note;
+        size_t namesz = ((size_t)nhdr->n_namesz + 3) & ~(size_t)3;
+        size_t descsz = ((size_t)nhdr->n_descsz + 3) & ~(size_t)3;
+        if((size_t)(end - note) - sizeof(Elf64_Nhdr) < namesz) break;
+        const uint8_t *desc = note + sizeof(Elf64_Nhdr) + namesz;
+        if((size_t)(end - desc) < nhdr->n_descsz) break;
+        if(pass == 0 && nhdr->n_type == NT_AUXV)
+          bias = FindLoadBias(desc, nhdr->n_descsz, &found_auxv);
+        if(pass == 1 && nhdr->n_type == NT_PRSTATUS &&
+          nhdr->n_descsz >= sizeof(struct elf_prstatus))
+        {
+          //the kernel writes the thread that took the signal first
+          PrintThreadBacktrace((const struct elf_prstatus *)desc, bias, threads_printed == 0);
+          threads_printed++;
+        }
+        if((size_t)(end - desc) < descsz) break;
+        note = desc + descsz;
+      }
+    }
+  }
+
+  CVectorDispose(g_vector_segments);
+  munmap(core, core_size);
+  ObjectFileClose();
+  return 0;
+}
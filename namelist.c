@@ -1,13 +1,238 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "symbols.h"
 
+#define STREAM_CHUNK_SIZE (4 << 20)	// bytes of log read per batch
+#define MAX_STREAM_THREADS 64
+
+/* Type: OUTPUT_BUFFER
+ * -------------------
+ * A growable byte buffer that one worker fills with its rewritten lines.
+ */
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+} OUTPUT_BUFFER;
+
+/* Type: STREAM_SLICE
+ * ------------------
+ * The run of whole lines [begin, end) handed to one worker, and the
+ * buffer it writes the symbolized copy into.
+ */
+typedef struct {
+	const char *begin;
+	const char *end;
+	OUTPUT_BUFFER out;
+} STREAM_SLICE;
+
+static void OutputReserve(OUTPUT_BUFFER *out, size_t extra)
+{
+	if(out->len + extra <= out->cap) return;
+	size_t cap = (out->cap == 0) ? 4096 : out->cap;
+	while(cap < out->len + extra) cap *= 2;
+	out->data = realloc(out->data, cap);
+	assert(out->data != NULL);
+	out->cap = cap;
+}
+
+static void OutputAppend(OUTPUT_BUFFER *out, const char *bytes, size_t n)
+{
+	OutputReserve(out, n);
+	memcpy(out->data + out->len, bytes, n);
+	out->len += n;
+}
+
+static int HexValue(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/* Function: IsSymbolized
+ * ----------------------
+ * Returns 1 if the text starting at p (just past a frame's closing bracket)
+ * already reads " name (+0xoffset)", i.e. the frame was symbolized before.
+ */
+static int IsSymbolized(const char *p, const char *end)
+{
+	if(p >= end || *p++ != ' ') return 0;
+	const char *name = p;
+	while(p < end && *p != ' ' && *p != '\n') p++;
+	if(p == name || end - p < 5 || memcmp(p, " (+0x", 5) != 0) return 0;
+	p += 5;
+	const char *digits = p;
+	while(p < end && HexValue(*p) >= 0) p++;
+	return p > digits && p < end && *p == ')';
+}
+
+/* Function: SymbolizeSlice
+ * ------------------------
+ * Copies the slice to its output buffer, appending " name (+0xoffset)"
+ * after every raw "[0x...]" frame whose address falls inside a known
+ * function. Frames that do not resolve, or that are already followed by
+ * " name (+0xoffset)", are copied unchanged, so running the tool over its
+ * own output changes nothing.
+ */
+static void *SymbolizeSlice(void *arg)
+{
+	STREAM_SLICE *slice = arg;
+	const char *p = slice->begin, *end = slice->end;
+	OutputReserve(&slice->out, end - p);
+	while(p < end) {
+		const char *bracket = memchr(p, '[', end - p);
+		if(bracket == NULL) break;
+		const char *q = bracket + 1;
+		if(end - q < 3 || q[0] != '0' || (q[1] != 'x' && q[1] != 'X')) {
+			OutputAppend(&slice->out, p, q - p);
+			p = q;
+			continue;
+		}
+		q += 2;
+		unsigned long long address = 0;
+		int digits = 0, value;
+		while(q < end && digits < 16 && (value = HexValue(*q)) >= 0) {
+			address = (address << 4) | value;
+			digits++;
+			q++;
+		}
+		if(digits == 0 || q >= end || *q != ']') {
+			OutputAppend(&slice->out, p, q - p);
+			p = q;
+			continue;
+		}
+		q++;
+		OutputAppend(&slice->out, p, q - p);
+		p = q;
+		if(IsSymbolized(p, end)) continue;
+		long long int offset;
+		const char *name = LookupAddress(address, &offset);
+		if(name != NULL) {
+			char suffix[32];
+			size_t name_len = strlen(name);
+			int suffix_len = snprintf(suffix, sizeof(suffix), " (+0x%llx)", offset);
+			OutputReserve(&slice->out, name_len + 1 + suffix_len);
+			slice->out.data[slice->out.len++] = ' ';
+			OutputAppend(&slice->out, name, name_len);
+			OutputAppend(&slice->out, suffix, suffix_len);
+		}
+	}
+	OutputAppend(&slice->out, p, end - p);
+	return NULL;
+}
+
+/* Function: SymbolizeBatch
+ * ------------------------
+ * Splits a batch of whole lines into one slice per worker, cutting only at
+ * newlines, symbolizes the slices in parallel and writes them back out in
+ * their original order.
+ */
+static void SymbolizeBatch(const char *batch, size_t len, STREAM_SLICE *slices,
+	int num_threads, FILE *out)
+{
+	pthread_t threads[MAX_STREAM_THREADS];
+	int started[MAX_STREAM_THREADS];
+	const char *begin = batch, *end = batch + len;
+	int used = 0;
+	for(int i = 0 ; i < num_threads && begin < end ; i++) {
+		const char *cut = end;
+		if(i < num_threads - 1 && (size_t)(end - begin) > len / num_threads) {
+			cut = memchr(begin + len / num_threads, '\n', end - begin - len / num_threads);
+			cut = (cut == NULL) ? end : cut + 1;
+		}
+		slices[i].begin = begin;
+		slices[i].end = cut;
+		slices[i].out.len = 0;
+		begin = cut;
+		used++;
+	}
+	if(used == 1) {
+		SymbolizeSlice(&slices[0]);
+	} else {
+		for(int i = 0 ; i < used ; i++) {
+			// out of threads: do this slice here rather than lose it
+			started[i] = (pthread_create(&threads[i], NULL, SymbolizeSlice, &slices[i]) == 0);
+			if(!started[i]) SymbolizeSlice(&slices[i]);
+		}
+		for(int i = 0 ; i < used ; i++)
+			if(started[i]) pthread_join(threads[i], NULL);
+	}
+	for(int i = 0 ; i < used ; i++)
+		fwrite(slices[i].out.data, 1, slices[i].out.len, out);
+}
+
+/* Function: SymbolizeStream
+ * -------------------------
+ * Reads the log on in in large chunks and writes it to out with every raw
+ * frame address symbolized. Each batch ends at the last complete line in
+ * the chunk; the partial line left over is carried into the next read.
+ */
+static void SymbolizeStream(FILE *in, FILE *out, int num_threads)
+{
+	STREAM_SLICE slices[MAX_STREAM_THREADS];
+	memset(slices, 0, sizeof(slices));
+	size_t cap = STREAM_CHUNK_SIZE, len = 0;
+	char *buf = malloc(cap);
+	assert(buf != NULL);
+	while(1) {
+		size_t n = fread(buf + len, 1, cap - len, in);
+		len += n;
+		if(n == 0) break;
+		const char *last = NULL;
+		for(const char *p = buf + len ; p > buf ; p--) {
+			if(p[-1] == '\n') {
+				last = p;
+				break;
+			}
+		}
+		if(last == NULL) {
+			if(len == cap) {		// one line longer than the buffer
+				cap *= 2;
+				buf = realloc(buf, cap);
+				assert(buf != NULL);
+			}
+			continue;
+		}
+		SymbolizeBatch(buf, last - buf, slices, num_threads, out);
+		len = buf + len - last;
+		memmove(buf, last, len);
+	}
+	if(len > 0)
+		SymbolizeBatch(buf, len, slices, num_threads, out);
+	fflush(out);
+	for(int i = 0 ; i < MAX_STREAM_THREADS ; i++)
+		free(slices[i].out.data);
+	free(buf);
+}
+
 int main(int argc, char *argv[])
 {
-	if(argc < 2)
+	if(argc < 2) {
 		fprintf(stderr, "You have to type file name\n");
-	ObjectFileOpen(argv[1]);
+		fprintf(stderr, "Usage: %s file [addr]\n       %s -s file [threads] < log\n",
+			argv[0], argv[0]);
+		return 1;
+	}
+	if(strcmp(argv[1], "-s") == 0) {
+		if(argc < 3) {
+			fprintf(stderr, "You have to type file name\n");
+			return 1;
+		}
+		int num_threads = (argc > 3) ? atoi(argv[3]) : 1;
+		if(num_threads < 1) num_threads = 1;
+		if(num_threads > MAX_STREAM_THREADS) num_threads = MAX_STREAM_THREADS;
+		if(ObjectFileOpen(argv[2]) != 0) return 1;
+		SymbolizeStream(stdin, stdout, num_threads);
+		ObjectFileClose();
+		return 0;
+	}
+	if(ObjectFileOpen(argv[1]) != 0) return 1;
 	long long int offset;
 	if(argc == 2)
 	  PrintSymtab();
@@ -14,11 +14,161 @@
 #include <stdlib.h> // exit
 #include <ucontext.h> // mcontext
 #include <stdint.h>
+#include <time.h> // clock_gettime
+#include <unistd.h> // syscall
+#include <sys/syscall.h> // SYS_gettid
+#include <pthread.h> // pthread_key_create
+#include "reporter.h"
 #include "symbols.h"
 
+/*
+ * Breadcrumb flight recorder
+ * --------------------------
+ * The first time a thread calls RecordBreadcrumb it claims a free ring out of
+ * a static pool by flipping the ring's state with a compare-and-swap, and from
+ * then on is the only writer of that ring, so recording needs no lock. A
+ * pthread key destructor hands the ring back when the thread exits. Sequence
+ * numbers keep counting across owners; first marks where the current owner
+ * began, so events left by an exited thread are never shown as the new
+ * owner's. Each entry carries the sequence number of the event it holds; the
+ * writer clears it before touching the other fields and publishes it last,
+ * which lets the signal handler detect and skip an entry that was being
+ * overwritten at the moment of the fault.
+ */
+#define BREADCRUMB_RING_SIZE 64          // must be a power of two
+#define MAX_BREADCRUMB_THREADS 64
+
+#define RING_FREE 0
+#define RING_CLAIMING 1                  // owner is still filling in tid/first
+#define RING_LIVE 2
+
+typedef struct {
+  const char *tag;
+  uint64_t timestamp;                    // CLOCK_MONOTONIC, in nanoseconds
+  long args[3];
+  uint64_t seq;                          // 1-based event number, 0 while being written
+} BREADCRUMB;
+
+typedef struct {
+  int state;                             // RING_FREE, RING_CLAIMING or RING_LIVE
+  pid_t tid;
+  uint64_t first;                        // sequence number of the owner's first event
+  uint64_t next;                         // sequence number of the last event recorded
+  BREADCRUMB entries[BREADCRUMB_RING_SIZE];
+} BREADCRUMB_RING;
+
+static BREADCRUMB_RING g_rings[MAX_BREADCRUMB_THREADS];
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static __thread BREADCRUMB_RING *t_ring = NULL;
+static __thread int t_ring_denied = 0;
+
+static uint64_t MonotonicNanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void ReleaseRing(void *ring_ptr)
+{
+    BREADCRUMB_RING *ring = (BREADCRUMB_RING *)ring_ptr;
+    t_ring = NULL;
+    __atomic_store_n(&ring->state, RING_FREE, __ATOMIC_RELEASE);
+}
+
+static void CreateRingKey(void)
+{
+    pthread_key_create(&g_ring_key, ReleaseRing);
+}
+
+static BREADCRUMB_RING *ClaimRing(void)
+{
+    pthread_once(&g_ring_key_once, CreateRingKey);
+    for(int i = 0 ; i < MAX_BREADCRUMB_THREADS ; i++)
+    {
+        BREADCRUMB_RING *ring = &g_rings[i];
+        int expected = RING_FREE;
+        if(!__atomic_compare_exchange_n(&ring->state, &expected, RING_CLAIMING, 0,
+          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+        ring->tid = (pid_t)syscall(SYS_gettid);
+        ring->first = ring->next + 1;
+        __atomic_store_n(&ring->state, RING_LIVE, __ATOMIC_RELEASE);
+        pthread_setspecific(g_ring_key, ring);
+        t_ring = ring;
+        return ring;
+    }
+    t_ring_denied = 1;
+    return NULL;
+}
+
+void RecordBreadcrumb(const char *tag, long arg0, long arg1, long arg2)
+{
+    BREADCRUMB_RING *ring = t_ring;
+    if(ring == NULL)
+    {
+        if(t_ring_denied || (ring = ClaimRing()) == NULL)
+            return;
+    }
+    uint64_t seq = ring->next + 1;
+    BREADCRUMB *entry = &ring->entries[(seq - 1) & (BREADCRUMB_RING_SIZE - 1)];
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->tag = tag;
+    entry->timestamp = MonotonicNanos();
+    entry->args[0] = arg0;
+    entry->args[1] = arg1;
+    entry->args[2] = arg2;
+    __atomic_store_n(&entry->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->next, seq, __ATOMIC_RELEASE);
+}
+
+/* Prints the surviving events of every live ring, oldest first. Entries whose
+ * sequence number changes while they are being copied were torn by a
+ * concurrent write and are left out.
+ */
+static void DumpBreadcrumbs(void)
+{
+    uint64_t now = MonotonicNanos();
+    int printed_header = 0;
+    for(int i = 0 ; i < MAX_BREADCRUMB_THREADS ; i++)
+    {
+        BREADCRUMB_RING *ring = &g_rings[i];
+        if(__atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) != RING_LIVE) continue;
+        uint64_t next = __atomic_load_n(&ring->next, __ATOMIC_ACQUIRE);
+        uint64_t first = (next >= BREADCRUMB_RING_SIZE) ? next - BREADCRUMB_RING_SIZE + 1 : 1;
+        if(first < ring->first) first = ring->first;
+        if(first > next) continue;
+        if(!printed_header)
+        {
+            printf("\nBreadcrumbs (now %llu.%09llu):\n", (unsigned long long)(now / 1000000000ull),
+              (unsigned long long)(now % 1000000000ull));
+            printed_header = 1;
+        }
+        printf("Thread %d:\n", (int)ring->tid);
+        for(uint64_t seq = first ; seq <= next ; seq++)
+        {
+            BREADCRUMB *entry = &ring->entries[(seq - 1) & (BREADCRUMB_RING_SIZE - 1)];
+            if(__atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE) != seq) continue;
+            BREADCRUMB copy = *entry;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) continue;
+            printf("  [%llu.%09llu] %s %ld %ld %ld\n",
+              (unsigned long long)(copy.timestamp / 1000000000ull),
+              (unsigned long long)(copy.timestamp % 1000000000ull),
+              copy.tag, copy.args[0], copy.args[1], copy.args[2]);
+        }
+    }
+    fflush(stdout);
+}
+
 static void SignalReceived(int signum, siginfo_t * siginfo, void *context)
 {
     printf("\nProgram received signal %d (%s)\n", signum, sys_siglist[signum]);
+    // the stack walk below trusts raw rbp values and can fault again on a
+    // corrupted stack, so get the breadcrumbs out first
+    DumpBreadcrumbs();
 
     // These two lines get the value of RIP register at time of crash, i.e.
     // address of instruction that faulted
@@ -17,4 +17,26 @@
  */
 void InitReporter();
 
+/*
+ * Function: RecordBreadcrumb
+ * --------------------------
+ * Records a small event (tag, timestamp and three integers) into the
+ * calling thread's flight recorder. Each thread owns a fixed-size ring
+ * that keeps only its most recent events; recording never takes a lock or
+ * allocates, so it is cheap enough for hot paths. When a fault is caught
+ * the rings of all threads are printed and flushed before the stack is
+ * walked, so a second fault during the walk cannot lose them. The tag is
+ * stored by pointer, so it must be a string literal (or otherwise outlive
+ * the process). The recorder holds 64 rings; a thread's ring is
+ * handed back when the thread exits, so the limit is on threads alive at the
+ * same time, not over the life of the process. A thread that starts while
+ * all 64 are taken records nothing for its whole lifetime.
+ *
+ * Do not call this from a signal handler. A call that interrupts the same
+ * thread's RecordBreadcrumb overwrites the entry being written, and a
+ * thread's first call claims its ring through pthread_once, which is not
+ * async-signal-safe.
+ */
+void RecordBreadcrumb(const char *tag, long arg0, long arg1, long arg2);
+
 #endif
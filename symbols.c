@@ -91,6 +91,7 @@ static void DisposeElfData(void *data, int size);
 int g_data_size;
 void *g_data_ptr = NULL;
 CVector *g_vector_symtab = NULL;
+CVector *g_vector_addr = NULL;   // same symbols as g_vector_symtab, sorted by address
 char **g_keep_str_ptr = NULL;
 
 
@@ -102,12 +103,30 @@ int symtab_compare(const void *elemAddr1, const void *elemAddr2)
     *(const char **)symbol_info2->name);
 }
 
+int address_compare(const void *elemAddr1, const void *elemAddr2)
+{
+  SYMBOL_INFO *symbol_info1 = (SYMBOL_INFO*) elemAddr1;
+  SYMBOL_INFO *symbol_info2 = (SYMBOL_INFO*) elemAddr2;
+  if(symbol_info1->address == symbol_info2->address) return 0;
+  return (symbol_info1->address < symbol_info2->address) ? -1 : 1;
+}
+
 int ObjectFileOpen(const char *filename)
 {
 	g_data_ptr = GetElfData(filename, &g_data_size);
+  if(g_data_ptr == NULL) return -1;
   dissectSymtab(g_data_ptr, &g_vector_symtab, &g_keep_str_ptr);
+  if(g_vector_symtab == NULL)
+  {
+    ObjectFileClose();
+    return -1;
+  }
   CVectorSort(g_vector_symtab, symtab_compare);
-  return (g_data_ptr != NULL) ? 0 : -1;
+  g_vector_addr = CVectorCreate(sizeof(SYMBOL_INFO), CVectorCount(g_vector_symtab), NULL);
+  for(int i = 0 ; i < CVectorCount(g_vector_symtab) ; i++)
+    CVectorAppend(g_vector_addr, CVectorNth(g_vector_symtab, i));
+  CVectorSort(g_vector_addr, address_compare);
+  return 0;
 }
 
 /* Function: GetElfData
@@ -160,17 +179,15 @@ static void dissectSymtab(void *elfData, CVector **vector_symtab, char ***keep_s
     //access every section entry
     sh_ptr = (Elf64_Shdr*)((uint8_t*)elfData + hdr->e_shoff) + i;
 
-    if((sh_ptr)->sh_type == SHT_STRTAB) //find the strtab entry
-    {
-      strtab_ptr = (uint8_t*)elfData + (sh_ptr)->sh_offset;
-      //printf("strtab_ptr = %s\n", strtab_ptr + (sh_ptr)->sh_name);
-      if(memcmp(strtab_ptr + (sh_ptr)->sh_name, ".shstrtab", sizeof(".shstrtab")) == 0)
-        strtab_ptr = NULL;
-    }
     if((sh_ptr)->sh_type == SHT_SYMTAB) //find symtab entry
     {
       symtab_ptr = (Elf64_Sym*) ((uint8_t*)elfData + (sh_ptr)->sh_offset);
       num_of_symbols = (sh_ptr)->sh_size / (sh_ptr)->sh_entsize;
+      //the symtab names its own string table through sh_link, which does not
+      //depend on where .strtab and .shstrtab happen to sit in the section list
+      Elf64_Shdr *strtab_sh = (Elf64_Shdr*)((uint8_t*)elfData + hdr->e_shoff) +
+        (sh_ptr)->sh_link;
+      strtab_ptr = (uint8_t*)elfData + strtab_sh->sh_offset;
       //printf("sh_size = %" PRIu64 "\n", (sh_ptr)->sh_size);
       //printf("sh_entsize = %" PRIu64 "\n", (sh_ptr)->sh_entsize);
     }
@@ -226,29 +243,72 @@ void PrintSymtab(void)
 
 int search_compare(const void *elemAddr1, const void *elemAddr2)
 {
-  int64_t addr = (int64_t)strtol(elemAddr1, NULL, 16);
+  Elf64_Addr addr = *(const Elf64_Addr *)elemAddr1;
   SYMBOL_INFO *symbol_info = (SYMBOL_INFO*) elemAddr2;
   /*printf("%016lx %016lx %c %s\n", symbol_info->address, symbol_info->size,
   (symbol_info->binding == STB_GLOBAL) ? 'T' : 't', *(const char **)
     symbol_info->name);*/
-  return (addr >= symbol_info->address && addr <= (symbol_info->address +
-    symbol_info->size)) ? 0 : -1;
+  if(addr < symbol_info->address) return -1;
+  if(symbol_info->size == 0)    // no extent, so only its own address belongs to it
+    return (addr == symbol_info->address) ? 0 : 1;
+  return (addr < (symbol_info->address + symbol_info->size)) ? 0 : 1;
+}
+
+/* Function: LookupAddress
+ * -----------------------
+ * Binary searches the address-sorted index for the last symbol starting at
+ * or below address, then checks that symbol (and any others starting at the
+ * same address) actually contains it. Returns the function name and sets
+ * *offset, or returns NULL without printing anything. The index is only
+ * read, so this may be called from several threads at once once
+ * ObjectFileOpen has returned. CVectorSearch is not used because the
+ * library turns the bsearch result back into an index with a linear scan.
+ */
+const char * LookupAddress(unsigned long long address, long long int *offset)
+{
+  if(g_vector_addr == NULL || CVectorCount(g_vector_addr) == 0) return NULL;
+  Elf64_Addr addr = address;
+  SYMBOL_INFO *symbols = (SYMBOL_INFO*) CVectorNth(g_vector_addr, 0);
+  int lo = 0, hi = CVectorCount(g_vector_addr);   // answer is in [lo - 1, hi)
+  while(lo < hi)
+  {
+    int mid = lo + (hi - lo) / 2;
+    if(symbols[mid].address <= addr) lo = mid + 1;
+    else hi = mid;
+  }
+  for(int i = lo - 1 ; i >= 0 && symbols[i].address == symbols[lo - 1].address ; i--)
+  {
+    if(search_compare(&addr, &symbols[i]) == 0)
+    {
+      *offset = addr-symbols[i].address;
+      return *(const char **) symbols[i].name;
+    }
+  }
+  return NULL;
 }
 
 char * SearchSymbol(const char *address, long long int *offset)
 {
-  int position = CVectorSearch(g_vector_symtab, address, search_compare, 0, 0);
-  int64_t addr = (int64_t)strtol(address, NULL, 16);
-  if(position == -1)
+  int64_t addr = (int64_t)strtoull(address, NULL, 16);
+  const char *name = LookupAddress(addr, offset);
+  if(name == NULL)
   {
     printf("Address %02lx not found in any symbol range\n", addr);
     return NULL;
   }
-  SYMBOL_INFO *symbol_info = (SYMBOL_INFO*) CVectorNth(g_vector_symtab, position);
-  *offset = addr-symbol_info->address;
-  /*printf("address %s matches %s+%02lx\n", address, *(const char **)
-    symbol_info->name, addr-symbol_info->address);*/
-  return *(const char **) symbol_info->name;
+  /*printf("address %s matches %s+%02lx\n", address, name, *offset);*/
+  return (char *) name;
+}
+
+/* Function: ObjectFileEntry
+ * -------------------------
+ * Returns the link-time entry point (e_entry) of the opened file. Comparing
+ * it with the entry point the kernel reported for a running process gives
+ * the load bias of a position-independent executable.
+ */
+unsigned long long ObjectFileEntry(void)
+{
+  return ((Elf64_Ehdr *)g_data_ptr)->e_entry;
 }
 
 static void DisposeElfData(void *data, int size)
@@ -259,6 +319,9 @@ static void DisposeElfData(void *data, int size)
 void ObjectFileClose(void)
 {
   if(g_keep_str_ptr != NULL) free(g_keep_str_ptr);
-  CVectorDispose(g_vector_symtab);
+  if(g_vector_symtab != NULL) CVectorDispose(g_vector_symtab);
+  if(g_vector_addr != NULL) CVectorDispose(g_vector_addr);
+  g_keep_str_ptr = NULL;
+  g_vector_symtab = g_vector_addr = NULL;
 	DisposeElfData(g_data_ptr, g_data_size);
 }
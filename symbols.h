@@ -12,6 +12,8 @@
 int ObjectFileOpen(const char *filename);
 void PrintSymtab(void);
 char * SearchSymbol(const char *address, long long int *offset);
+const char * LookupAddress(unsigned long long address, long long int *offset);
+unsigned long long ObjectFileEntry(void);
 void ObjectFileClose(void);
 
 